@@ -3,6 +3,8 @@
 #include "Analyzer.h"
 #include "Settings.h"
 #include "Results.h"
+#include "Stream.h"
+#include "Statistics.h"
 
 I2cAnalyzer::I2cAnalyzer(): Analyzer2(), settings(new I2cAnalyzerSettings()) {
 	SetAnalyzerSettings(settings.get());
@@ -19,13 +21,33 @@ void I2cAnalyzer::SetupResults() {
 	results->AddChannelBubblesWillAppearOn(settings->sda_channel);
 }
 
-void I2cAnalyzer::WorkerThread() {
-	if (settings->min_width_ns == 0) {
-		min_width_samples = 0;
-	} else {
-		min_width_samples = settings->min_width_ns / ((U64)1000000000U / (U64)GetSampleRate());
+U32 I2cAnalyzer::GetMinimumSampleRateHz() {
+	/* the shortest specified SCL high time (tHIGH) for each mode, which is
+	 * shorter than the low time in all modes */
+	U32 t_high_ns;
+	switch (settings->bus_rate_hz) {
+		case 3400000: t_high_ns = 60;   break;
+		case 1000000: t_high_ns = 260;  break;
+		case 400000:  t_high_ns = 600;  break;
+		default:      t_high_ns = 4000; break;
 	}
 
+	/* at least 2 samples within each high period */
+	U64 rate = ((U64)2000000000U + t_high_ns - 1) / t_high_ns;
+	return (rate > 2000000) ? (U32)rate : 2000000;
+}
+
+/* rounds down, so a width shorter than one sample disables the filter */
+U32 I2cAnalyzer::NsToSamples(U32 ns) {
+	if (ns == 0) return 0;
+	return ns / ((U64)1000000000U / (U64)GetSampleRate());
+}
+
+void I2cAnalyzer::WorkerThread() {
+	min_width_fs_samples = NsToSamples(settings->min_width_ns);
+	min_width_hs_samples = NsToSamples(settings->hs_min_width_ns);
+	min_width_samples = min_width_fs_samples;
+
 	scl = GetAnalyzerChannelData(settings->scl_channel);
 	sda = GetAnalyzerChannelData(settings->sda_channel);
 
@@ -40,9 +62,24 @@ void I2cAnalyzer::WorkerThread() {
 	bit_index = 0;
 	cur_byte = 0;
 	cur_addr = 0;
+	cur_addr_type = ADDRESS_TYPE_7BIT;
+	addr_len = 1;
+	addr_complete = true;
+	addr_ack = false;
+	ten_bit_addressed = false;
+	hs_mode = false;
+	packet_hs = false;
 	frame_markers.clear();
 	payload.clear();
 
+	stream.reset(settings->stream_enable ? new I2cStreamWriter(settings->stream_path.c_str()) : NULL);
+
+	U64 stats_bucket_samples = ((U64)settings->stats_interval_ms * (U64)GetSampleRate()) / 1000U;
+	{
+		std::lock_guard<std::mutex> l(statistics_lock);
+		statistics.reset(stats_bucket_samples > 0 ? new I2cStatistics(stats_bucket_samples) : NULL);
+	}
+
 	for (;;) {
 		ParseWaveform();
 		CheckIfThreadShouldExit();
@@ -92,6 +129,11 @@ void I2cAnalyzer::ParseWaveform() {
 
 	AdvanceOverGlitches(pos, scl_state, sda_state);
 
+	if ((statistics.get() != NULL) && !seen_start) {
+		/* the bus is idle, close any buckets that the edge has passed */
+		CloseStatisticsBuckets(pos);
+	}
+
 	bool cond_start  = (scl_state == SIGNAL_HIGH) && (sda_state == SIGNAL_FALLING);
 	bool cond_stop   = (scl_state == SIGNAL_HIGH) && (sda_state == SIGNAL_RISING) && seen_start;
 	bool cond_sample = (scl_state == SIGNAL_RISING) && seen_start;
@@ -145,10 +187,6 @@ void I2cAnalyzer::ParseWaveform() {
 			cur_byte = (cur_byte << 1) | (sda_is_high ? 0x1 : 0x0);
 
 		} else {
-			if (byte_index == 0) {
-				addr_ack = !sda_is_high;
-			}
-
 			AddFrameMarker(pos, AnalyzerResults::UpArrow, sda_is_high ? AnalyzerResults::ErrorSquare: AnalyzerResults::Square);
 			SubmitFrame(pos, sda_is_high);
 			payload.push_back(cur_byte);
@@ -160,15 +198,94 @@ void I2cAnalyzer::ParseWaveform() {
 	}
 }
 
+/* called for each of the address bytes at the start of a transaction, to
+ * assemble cur_addr:
+ *   - 0000 1xxx       Hs-mode master code, the bus switches to Hs after the NAK
+ *   - 1111 0aa0 aaaa  10-bit write address, split across two bytes
+ *   - 1111 0aa1       10-bit read, following a repeated start after the write
+ *   - aaaa aaar       7-bit address
+ */
+void I2cAnalyzer::DecodeAddress(bool sda_is_high) {
+	addr_ack = !sda_is_high;
+
+	if (byte_index == 1) {
+		/* second byte of a 10-bit write address */
+		cur_addr |= (uint16_t)cur_byte << 1;
+		addr_complete = true;
+		ten_bit_addressed = addr_ack;
+		return;
+	}
+
+	addr_len = 1;
+	addr_complete = true;
+	packet_hs = hs_mode;
+
+	if ((cur_byte & 0xf8) == 0x08) {
+		cur_addr = cur_byte;
+		cur_addr_type = ADDRESS_TYPE_MASTER_CODE;
+
+		hs_mode = true;
+		min_width_samples = min_width_hs_samples;
+
+	} else if ((cur_byte & 0xf8) == 0xf0) {
+		uint16_t addr_high = (uint16_t)(cur_byte & 0x06) << 8;
+
+		if (!(cur_byte & 1)) {
+			/* only an ACK'd second byte makes the following read addressable */
+			ten_bit_addressed = false;
+			cur_addr = addr_high;
+			addr_len = 2;
+			addr_complete = false;
+		} else if (ten_bit_addressed && (cur_addr_type == ADDRESS_TYPE_10BIT) && ((cur_addr & 0x600) == addr_high)) {
+			/* the low bits come from the preceding write */
+			cur_addr |= 1;
+		} else {
+			/* no preceding write, so the low bits are unknown */
+			cur_addr = addr_high | 1;
+			addr_complete = false;
+		}
+		cur_addr_type = ADDRESS_TYPE_10BIT;
+
+	} else {
+		cur_addr = cur_byte;
+		cur_addr_type = ADDRESS_TYPE_7BIT;
+	}
+}
+
 /* return true if frame should be presented to the user */
 bool I2cAnalyzer::CheckFilter() {
-	uint8_t a = (cur_addr >> 1) & 0xf7;
+	if (!settings->filter_address_enable) {
+		return true;
+	}
 
-	if (settings->filter_address_enable && (settings->filter_address != a)) {
+	if (cur_addr_type == ADDRESS_TYPE_MASTER_CODE) {
 		return false;
 	}
 
-	return true;
+	if ((cur_addr_type == ADDRESS_TYPE_10BIT) != settings->filter_address_10bit) {
+		return false;
+	}
+
+	uint16_t a = cur_addr >> 1;
+
+	if (!addr_complete) {
+		/* a partial 10-bit address may or may not be the nominated one, so
+		 * the prefix frame isn't shown... the matching address frame is */
+		return false;
+	}
+
+	return settings->filter_address == a;
+}
+
+/* 7-bit addresses are a byte, 10-bit addresses are an integer under their own key */
+void I2cAnalyzer::AddAddressV2(FrameV2 &framev2) {
+	if (cur_addr_type != ADDRESS_TYPE_10BIT) {
+		framev2.AddByte("address", cur_addr >> 1);
+	} else if (addr_complete) {
+		framev2.AddInteger("address_10bit", cur_addr >> 1);
+	} else {
+		framev2.AddBoolean("address_unknown", true);
+	}
 }
 
 void I2cAnalyzer::AddFrameMarker(U64 pos, AnalyzerResults::MarkerType scl, AnalyzerResults::MarkerType sda) {
@@ -203,6 +320,9 @@ void I2cAnalyzer::SubmitStop(U64 pos) {
 
 	seen_start = false;
 	seen_stop = true;
+	ten_bit_addressed = false;
+	hs_mode = false;
+	min_width_samples = min_width_fs_samples;
 }
 
 void I2cAnalyzer::SubmitError(U64 pos) {
@@ -218,6 +338,9 @@ void I2cAnalyzer::SubmitError(U64 pos) {
 
 	seen_start = false;
 	seen_stop = true;
+	ten_bit_addressed = false;
+	hs_mode = false;
+	min_width_samples = min_width_fs_samples;
 }
 
 void I2cAnalyzer::SubmitFrame(U64 pos, bool sda_is_high) {
@@ -228,24 +351,47 @@ void I2cAnalyzer::SubmitFrame(U64 pos, bool sda_is_high) {
 	}
 	frame_markers.clear();
 
-	if (byte_index == 0) cur_addr = cur_byte;
+	bool is_addr = byte_index < addr_len;
+	if (is_addr) DecodeAddress(sda_is_high);
 
 	if (CheckFilter()) {
+		U8 frame_type = FRAME_TYPE_DATA;
+		if (is_addr) {
+			if (cur_addr_type == ADDRESS_TYPE_MASTER_CODE) {
+				frame_type = FRAME_TYPE_MASTER_CODE;
+			} else if (byte_index + 1 < addr_len) {
+				frame_type = FRAME_TYPE_ADDRESS_PREFIX;
+			} else {
+				frame_type = FRAME_TYPE_ADDRESS;
+			}
+		}
+
+		U8 frame_flags = !sda_is_high ? FRAME_FLAG_ACK : 0;
+		if (cur_addr_type == ADDRESS_TYPE_10BIT) frame_flags |= FRAME_FLAG_10BIT;
+		if (packet_hs) frame_flags |= FRAME_FLAG_HS;
+		if (!addr_complete) frame_flags |= FRAME_FLAG_ADDRESS_UNKNOWN;
+
 		Frame frame;
 		frame.mStartingSampleInclusive = pos_frame_start;
 		frame.mEndingSampleInclusive = pos;
 		frame.mData1 = (cur_addr << 8) | cur_byte;
-		frame.mType = byte_index == 0 ? FRAME_TYPE_ADDRESS : FRAME_TYPE_DATA;
-		frame.mFlags = !sda_is_high ? FRAME_FLAG_ACK : 0;
+		frame.mType = frame_type;
+		frame.mFlags = frame_flags;
 		results->AddFrame(frame);
 
 		if (settings->gen_frames) {
 			FrameV2 framev2;
 			framev2.AddBoolean("ack", !sda_is_high);
-			if (byte_index == 0) {
+			if (frame_type == FRAME_TYPE_ADDRESS) {
 				framev2.AddString("mode", "setup");
-				framev2.AddBoolean("read", cur_byte & 1 ? true : false);
-				framev2.AddByte("address", cur_byte >> 1);
+				framev2.AddBoolean("read", cur_addr & 1 ? true : false);
+				AddAddressV2(framev2);
+			} else if (frame_type == FRAME_TYPE_ADDRESS_PREFIX) {
+				framev2.AddString("mode", "prefix");
+				framev2.AddByte("data", cur_byte);
+			} else if (frame_type == FRAME_TYPE_MASTER_CODE) {
+				framev2.AddString("mode", "master code");
+				framev2.AddByte("code", cur_byte & 0x07);
 			} else {
 				framev2.AddString("mode", "data");
 				framev2.AddByte("data", cur_byte);
@@ -260,16 +406,49 @@ void I2cAnalyzer::SubmitFrame(U64 pos, bool sda_is_high) {
 void I2cAnalyzer::SubmitPacket(U64 pos, bool is_restart, bool has_error) {
 	if (payload.size() == 0) return;
 
-	if (CheckFilter() && settings->gen_transactions) {
-		FrameV2 framev2;
-		framev2.AddString("mode", "packet");
-		framev2.AddBoolean("ack", addr_ack);
-		framev2.AddBoolean("restart", is_restart);
-		framev2.AddBoolean("error", has_error);
-		framev2.AddBoolean("read", payload[0] & 1 ? true : false);
-		framev2.AddByte("address", payload[0] >> 1);
-		framev2.AddByteArray("payload", &(payload[1]), payload.size()-1);
-		results->AddFrameV2(framev2, "transaction", pos_packet_start, pos);
+	/* the address may have been cut short by an error or restart */
+	size_t data_index = (payload.size() > addr_len) ? addr_len : payload.size();
+	const U8 *data = payload.data() + data_index;
+	size_t data_len = payload.size() - data_index;
+
+	if (cur_addr_type == ADDRESS_TYPE_MASTER_CODE) {
+		if (CheckFilter() && settings->gen_transactions) {
+			FrameV2 framev2;
+			framev2.AddString("mode", "master code");
+			framev2.AddBoolean("ack", addr_ack);
+			framev2.AddBoolean("restart", is_restart);
+			framev2.AddBoolean("error", has_error);
+			framev2.AddByte("code", cur_addr & 0x07);
+			results->AddFrameV2(framev2, "transaction", pos_packet_start, pos);
+		}
+
+		if (statistics.get() != NULL) {
+			SubmitStatistics(pos, has_error, data_len);
+		}
+
+	} else {
+		if (CheckFilter() && settings->gen_transactions) {
+			FrameV2 framev2;
+			framev2.AddString("mode", "packet");
+			framev2.AddBoolean("ack", addr_ack);
+			framev2.AddBoolean("restart", is_restart);
+			framev2.AddBoolean("error", has_error);
+			framev2.AddBoolean("read", cur_addr & 1 ? true : false);
+			AddAddressV2(framev2);
+			if (packet_hs) {
+				framev2.AddBoolean("hs", true);
+			}
+			framev2.AddByteArray("payload", data, data_len);
+			results->AddFrameV2(framev2, "transaction", pos_packet_start, pos);
+		}
+
+		if ((stream.get() != NULL) && CheckFilter()) {
+			SubmitStream(pos, is_restart, has_error, data, data_len);
+		}
+
+		if (statistics.get() != NULL) {
+			SubmitStatistics(pos, has_error, data_len);
+		}
 	}
 
 	payload.clear();
@@ -278,6 +457,99 @@ void I2cAnalyzer::SubmitPacket(U64 pos, bool is_restart, bool has_error) {
 	results->CommitResults();
 }
 
+void I2cAnalyzer::SubmitStream(U64 pos, bool is_restart, bool has_error, const U8 *data, size_t data_len) {
+	U64 trigger_sample = GetTriggerSample();
+	double ns_per_sample = 1e9 / (double)GetSampleRate();
+
+	S64 start_ns = (S64)((double)((S64)pos_packet_start - (S64)trigger_sample) * ns_per_sample);
+	S64 end_ns = (S64)((double)((S64)pos - (S64)trigger_sample) * ns_per_sample);
+
+	U8 flags = 0;
+	if (cur_addr & 1)   flags |= STREAM_FLAG_READ;
+	if (addr_ack)       flags |= STREAM_FLAG_ACK;
+	if (is_restart)     flags |= STREAM_FLAG_RESTART;
+	if (has_error)      flags |= STREAM_FLAG_ERROR;
+	if (cur_addr_type == ADDRESS_TYPE_10BIT) flags |= STREAM_FLAG_10BIT;
+	if (packet_hs)      flags |= STREAM_FLAG_HS;
+	if (!addr_complete) flags |= STREAM_FLAG_ADDRESS_UNKNOWN;
+
+	stream->Submit(start_ns, end_ns, cur_addr >> 1, flags, data, data_len);
+}
+
+void I2cAnalyzer::SubmitStatistics(U64 pos, bool has_error, size_t data_len) {
+	/* close out any buckets that finished before this transaction began */
+	CloseStatisticsBuckets(pos_packet_start);
+
+	std::lock_guard<std::mutex> l(statistics_lock);
+	if ((cur_addr_type == ADDRESS_TYPE_MASTER_CODE) || !addr_complete) {
+		/* master codes have no target, and a guessed address mustn't be
+		 * credited to a real device - but both still occupy the bus */
+		statistics->SubmitBusy(pos_packet_start, pos);
+	} else {
+		statistics->Submit(pos_packet_start, pos, cur_addr >> 1, cur_addr_type == ADDRESS_TYPE_10BIT, cur_addr & 1 ? true : false, addr_ack, has_error, data_len);
+	}
+}
+
+/* the capture has no defined end from the analyzer's point of view, so the
+ * per-address rows carry running totals - the latest row for each address
+ * is the summary of the capture so far */
+void I2cAnalyzer::SubmitStatisticsBucket() {
+	FrameV2 framev2;
+	framev2.AddString("mode", "utilisation");
+	framev2.AddDouble("utilisation", (100.0 * (double)statistics->bucket_busy) / (double)statistics->bucket_samples);
+	framev2.AddInteger("transactions", statistics->bucket_transactions);
+	results->AddFrameV2(framev2, "statistics", statistics->bucket_start, statistics->bucket_end - 1);
+
+	for (size_t i = 0; i < STATISTICS_ADDRESS_COUNT; i += 1) {
+		SubmitStatisticsAddress((U16)i, false, statistics->addresses[i]);
+	}
+	for (size_t i = 0; i < STATISTICS_ADDRESS_10BIT_COUNT; i += 1) {
+		SubmitStatisticsAddress((U16)i, true, statistics->addresses_10bit[i]);
+	}
+
+	results->CommitResults();
+}
+
+void I2cAnalyzer::CloseStatisticsBuckets(U64 pos) {
+	while (statistics->BucketDue(pos)) {
+		if (statistics->BucketActive()) SubmitStatisticsBucket();
+
+		std::lock_guard<std::mutex> l(statistics_lock);
+		statistics->NextBucket(pos);
+	}
+}
+
+bool I2cAnalyzer::GetStatisticsSnapshot(I2cStatistics &snapshot) {
+	std::lock_guard<std::mutex> l(statistics_lock);
+
+	if (statistics.get() == NULL) return false;
+
+	snapshot = *statistics;
+	return true;
+}
+
+void I2cAnalyzer::SubmitStatisticsAddress(U16 address, bool is_10bit, const I2cAddressStatistics &a) {
+	if (!a.active) return;
+
+	if (settings->filter_address_enable) {
+		if ((settings->filter_address_10bit != is_10bit) || (settings->filter_address != address)) return;
+	}
+
+	FrameV2 framev2;
+	framev2.AddString("mode", "address");
+	if (is_10bit) {
+		framev2.AddInteger("address_10bit", address);
+	} else {
+		framev2.AddByte("address", (U8)address);
+	}
+	framev2.AddInteger("reads", a.reads);
+	framev2.AddInteger("writes", a.writes);
+	framev2.AddInteger("bytes", a.bytes);
+	framev2.AddInteger("naks", a.naks);
+	framev2.AddInteger("errors", a.errors);
+	framev2.AddDouble("bus_time", (double)a.bus_samples / (double)GetSampleRate());
+	results->AddFrameV2(framev2, "statistics", statistics->bucket_start, statistics->bucket_end - 1);
+}
 
 const char *GetAnalyzerName() {
 	return ANALYZER_NAME;
@@ -1,6 +1,8 @@
 #ifndef I2C_ANALYZER_H
 #define I2C_ANALYZER_H
 
+#include <mutex>
+
 #include <Analyzer.h>
 #include <AnalyzerResults.h>
 
@@ -8,6 +10,9 @@
 
 class I2cAnalyzerSettings;
 class I2cAnalyzerResults;
+class I2cStreamWriter;
+class I2cStatistics;
+struct I2cAddressStatistics;
 
 enum SignalState {
 	SIGNAL_UNKNOWN,
@@ -20,6 +25,14 @@ enum SignalState {
 enum FrameTypes {
 	FRAME_TYPE_ADDRESS,
 	FRAME_TYPE_DATA,
+	FRAME_TYPE_ADDRESS_PREFIX, /* first byte of a 10-bit write address */
+	FRAME_TYPE_MASTER_CODE,    /* Hs-mode master code */
+};
+
+enum AddressTypes {
+	ADDRESS_TYPE_7BIT,
+	ADDRESS_TYPE_10BIT,
+	ADDRESS_TYPE_MASTER_CODE,
 };
 
 struct FrameMarker {
@@ -28,7 +41,10 @@ struct FrameMarker {
 	AnalyzerResults::MarkerType sda;
 };
 
-#define FRAME_FLAG_ACK (1 << 0)
+#define FRAME_FLAG_ACK   (1 << 0)
+#define FRAME_FLAG_10BIT (1 << 1)
+#define FRAME_FLAG_HS    (1 << 2)
+#define FRAME_FLAG_ADDRESS_UNKNOWN (1 << 3) /* low bits of a 10-bit address are unknown */
 
 class I2cAnalyzer: public Analyzer2 {
 	public:
@@ -39,32 +55,47 @@ class I2cAnalyzer: public Analyzer2 {
 
 		virtual const char *GetAnalyzerName() const { return ANALYZER_NAME; };
 
-		virtual U32 GetMinimumSampleRateHz() { return 2000000; };
+		virtual U32 GetMinimumSampleRateHz();
 		virtual bool NeedsRerun() { return false; };
 
 		virtual U32 GenerateSimulationData(U64 newest_sample_requested, U32 sample_rate, SimulationChannelDescriptor **simulation_channels) { return 0; };
 
+		bool GetStatisticsSnapshot(I2cStatistics &snapshot);
+
 #pragma warning( push )
 #pragma warning( disable : 4251 ) // warning C4251: 'SerialAnalyzer::<...>' : class <...> needs to have dll-interface to be used by clients of class
 
 	protected:
+		U32 NsToSamples(U32 ns);
 		void AdvanceToNextEdge(U64 pos, AnalyzerChannelData *&channel, BitState &next);
 		void ResolveCurrentState(U64 pos, AnalyzerChannelData *&channel, BitState &next, SignalState &state);
 		void AdvanceOverGlitches(U64 &pos, SignalState &scl_state, SignalState &sda_state);
 
 		void ParseWaveform();
+		void DecodeAddress(bool sda_is_high);
 		bool CheckFilter();
+		void AddAddressV2(FrameV2 &framev2);
 		void AddFrameMarker(U64 pos, AnalyzerResults::MarkerType scl, AnalyzerResults::MarkerType sda);
 		void SubmitStart(U64 pos);
 		void SubmitStop(U64 pos);
 		void SubmitError(U64 pos);
 		void SubmitFrame(U64 pos, bool sda_is_high);
 		void SubmitPacket(U64 pos, bool is_restart, bool has_error);
+		void SubmitStream(U64 pos, bool is_restart, bool has_error, const U8 *data, size_t data_len);
+		void SubmitStatistics(U64 pos, bool has_error, size_t data_len);
+		void SubmitStatisticsBucket();
+		void CloseStatisticsBuckets(U64 pos);
+		void SubmitStatisticsAddress(U16 address, bool is_10bit, const I2cAddressStatistics &a);
 
 		std::auto_ptr<I2cAnalyzerSettings> settings;
 		std::auto_ptr<I2cAnalyzerResults> results;
+		std::auto_ptr<I2cStreamWriter> stream;
+		std::auto_ptr<I2cStatistics> statistics;
+		std::mutex statistics_lock; /* guards statistics against GetStatisticsSnapshot() */
 
-		U32 min_width_samples;
+		U32 min_width_samples; /* glitch filter for the current segment */
+		U32 min_width_fs_samples;
+		U32 min_width_hs_samples;
 
 		AnalyzerChannelData *scl;
 		AnalyzerChannelData *sda;
@@ -79,7 +110,13 @@ class I2cAnalyzer: public Analyzer2 {
 		uint8_t bit_index;
 		uint8_t cur_byte;
 		uint16_t cur_addr; /* the full address, including r/w flag */
-		bool addr_ack; /* did the initial address frame recieve an ACK? */
+		AddressTypes cur_addr_type;
+		size_t addr_len; /* number of address bytes at the start of the payload */
+		bool addr_complete; /* false while the low bits of a 10-bit address are unknown */
+		bool addr_ack; /* did the final address frame recieve an ACK? */
+		bool ten_bit_addressed; /* has a 10-bit write address been ACK'd since the last stop? */
+		bool hs_mode; /* has a master code switched the bus into Hs-mode until the next stop? */
+		bool packet_hs; /* was the current packet addressed in Hs-mode? */
 
 		std::vector<FrameMarker> frame_markers;
 		std::vector<uint8_t> payload;
@@ -1,18 +1,26 @@
 #include <sstream>
+#include <stdio.h>
 #include <AnalyzerHelpers.h>
 
 #include "Analyzer.h"
 #include "Results.h"
 #include "Settings.h"
+#include "Statistics.h"
 
-I2cAnalyzerResults::I2cAnalyzerResults(I2cAnalyzer *analyzer, I2cAnalyzerSettings *settings): AnalyzerResults(), analyzer(analyzer), settings(settings) { }
+I2cAnalyzerResults::I2cAnalyzerResults(I2cAnalyzer *analyzer, I2cAnalyzerSettings *settings): AnalyzerResults(), analyzer(analyzer), settings(settings) {
+	AddExportOption(EXPORT_TYPE_TRANSACTIONS, "Export transactions as CSV");
+	AddExportExtension(EXPORT_TYPE_TRANSACTIONS, "CSV", "csv");
+
+	AddExportOption(EXPORT_TYPE_STATISTICS, "Export statistics summary as CSV");
+	AddExportExtension(EXPORT_TYPE_STATISTICS, "CSV", "csv");
+}
 
 void I2cAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel &channel, DisplayBase display_base) {
 	ClearResultStrings();
 	Frame frame = GetFrame(frame_index);
 
 	char num[64];
-	uint16_t cur_addr = (frame.mData1 >> 8) & 0xff;
+	uint16_t cur_addr = (frame.mData1 >> 8) & 0x7ff;
 	uint8_t cur_byte = (frame.mData1 >> 0) & 0xff;
 
 	AnalyzerHelpers::GetNumberString(cur_byte, display_base, 8, num, sizeof(num));
@@ -29,7 +37,21 @@ void I2cAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel &channel, D
 		mode_short = is_read ? "R " : "W ";
 		mode_long = is_read ? "Read " : "Write ";
 
-		AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 7, num, sizeof(num));
+		if (frame.mFlags & FRAME_FLAG_ADDRESS_UNKNOWN) {
+			snprintf(num, sizeof(num), "?");
+		} else if (frame.mFlags & FRAME_FLAG_10BIT) {
+			AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 10, num, sizeof(num));
+		} else {
+			AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 7, num, sizeof(num));
+		}
+
+	} else if (frame.mType == FRAME_TYPE_ADDRESS_PREFIX) {
+		mode_short = "10 ";
+		mode_long = "10-bit Address ";
+
+	} else if (frame.mType == FRAME_TYPE_MASTER_CODE) {
+		mode_short = "Hs ";
+		mode_long = "Hs Master Code ";
 
 	} else if (frame.mType == FRAME_TYPE_DATA) {
 		mode_short = "";
@@ -63,6 +85,11 @@ void I2cAnalyzerResults::GenerateBubbleText(U64 frame_index, Channel &channel, D
 }
 
 void I2cAnalyzerResults::GenerateExportFile(const char *filename, DisplayBase display_base, U32 export_type_user_id) {
+	if (export_type_user_id == EXPORT_TYPE_STATISTICS) {
+		GenerateStatisticsExportFile(filename, display_base);
+		return;
+	}
+
 	const U64 trigger_sample = analyzer->GetTriggerSample();
     const U32 sample_rate = analyzer->GetSampleRate();
 
@@ -71,6 +98,8 @@ void I2cAnalyzerResults::GenerateExportFile(const char *filename, DisplayBase di
 	std::stringstream payload;
 	size_t payload_len = 0;
 	char num[70];
+	U64 addr_start = 0;
+	bool addr_prefix = false;
 
 	ss << "Time (s),Read/Write,Address,ACK/NAK,Length,Data" << std::endl;
 	AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
@@ -80,22 +109,46 @@ void I2cAnalyzerResults::GenerateExportFile(const char *filename, DisplayBase di
 	for (U64 i = 0; i < num_frames; i += 1) {
 		Frame frame = GetFrame(i);
 
-		uint16_t cur_addr = (frame.mData1 >> 8) & 0xff;
+		uint16_t cur_addr = (frame.mData1 >> 8) & 0x7ff;
 		uint8_t cur_byte = (frame.mData1 >> 0) & 0xff;
 
-		if (frame.mType == FRAME_TYPE_ADDRESS) {
+		if (frame.mType == FRAME_TYPE_MASTER_CODE) {
+			/* master codes aren't addressed to anyone */
+			addr_prefix = false;
+			continue;
+
+		} else if (frame.mType == FRAME_TYPE_ADDRESS_PREFIX) {
+			/* the row starts with the first byte of a 10-bit address */
+			addr_start = frame.mStartingSampleInclusive;
+			addr_prefix = true;
+			continue;
+
+		} else if (frame.mType == FRAME_TYPE_ADDRESS) {
 			if (ss.str().length() > 0) {
 				ss << payload_len << "," << payload.str() << std::endl;
 				AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
 				ss.str("");
 			}
 
-			AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive, trigger_sample, sample_rate, num, sizeof(num));
+			/* only the second byte of a 10-bit write follows a prefix */
+			bool follows_prefix = addr_prefix && (frame.mFlags & FRAME_FLAG_10BIT) && !(cur_addr & 1);
+			if (!follows_prefix) {
+				addr_start = frame.mStartingSampleInclusive;
+			}
+			addr_prefix = false;
+
+			AnalyzerHelpers::GetTimeString(addr_start, trigger_sample, sample_rate, num, sizeof(num));
 			ss << num << ",";
 
 			ss << ((cur_addr & 1) ? "Read" : "Write") << ",";
 
-			AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 7, num, sizeof(num));
+			if (frame.mFlags & FRAME_FLAG_ADDRESS_UNKNOWN) {
+				snprintf(num, sizeof(num), "?");
+			} else if (frame.mFlags & FRAME_FLAG_10BIT) {
+				AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 10, num, sizeof(num));
+			} else {
+				AnalyzerHelpers::GetNumberString(cur_addr >> 1, display_base, 7, num, sizeof(num));
+			}
 			ss << num << ",";
 
 			ss << ((frame.mFlags & FRAME_FLAG_ACK) ? "ACK" : "NAK") << ",";
@@ -106,6 +159,9 @@ void I2cAnalyzerResults::GenerateExportFile(const char *filename, DisplayBase di
 			continue;
 
 		} else if (frame.mType == FRAME_TYPE_DATA) {
+			/* a prefix cut short by an error or restart */
+			addr_prefix = false;
+
 			if (payload.str().length() > 0) {
 				payload << " ";
 			}
@@ -129,3 +185,83 @@ void I2cAnalyzerResults::GenerateExportFile(const char *filename, DisplayBase di
 	UpdateExportProgressAndCheckForCancel(num_frames, num_frames);
 	AnalyzerHelpers::EndFile(f);
 }
+
+static void AppendAddressStatistics(std::stringstream &ss, U16 address, bool is_10bit, const I2cAddressStatistics &a, DisplayBase display_base, double sample_period) {
+	if ((a.reads + a.writes) == 0) return;
+
+	char num[70];
+	AnalyzerHelpers::GetNumberString(address, display_base, is_10bit ? 10 : 7, num, sizeof(num));
+
+	ss << num << "," << (is_10bit ? "10-bit" : "7-bit") << ",";
+	ss << a.reads << "," << a.writes << "," << a.bytes << "," << a.naks << "," << a.errors << ",";
+	ss << ((double)a.bus_samples * sample_period) << std::endl;
+}
+
+static void AppendBucketStatistics(std::stringstream &ss, const I2cBucketStatistics &b, U64 bucket_samples, U64 trigger_sample, U32 sample_rate) {
+	char num[70];
+
+	AnalyzerHelpers::GetTimeString(b.start, trigger_sample, sample_rate, num, sizeof(num));
+	ss << num << ",";
+	AnalyzerHelpers::GetTimeString(b.end, trigger_sample, sample_rate, num, sizeof(num));
+	ss << num << ",";
+
+	ss << ((100.0 * (double)b.busy) / (double)bucket_samples) << "," << b.transactions << std::endl;
+}
+
+void I2cAnalyzerResults::GenerateStatisticsExportFile(const char *filename, DisplayBase display_base) {
+	const U64 trigger_sample = analyzer->GetTriggerSample();
+	const U32 sample_rate = analyzer->GetSampleRate();
+	const double sample_period = 1.0 / (double)sample_rate;
+
+	/* the worker thread may still be running, so work from a copy */
+	std::auto_ptr<I2cStatistics> snapshot(new I2cStatistics(0));
+	bool have_stats = analyzer->GetStatisticsSnapshot(*snapshot);
+
+	void *f = AnalyzerHelpers::StartFile(filename);
+	std::stringstream ss;
+
+	ss << "Address,Addressing,Reads,Writes,Bytes,NAKs,Errors,Bus Time (s)" << std::endl;
+	if (have_stats) {
+		for (size_t i = 0; i < STATISTICS_ADDRESS_COUNT; i += 1) {
+			AppendAddressStatistics(ss, (U16)i, false, snapshot->addresses[i], display_base, sample_period);
+		}
+		for (size_t i = 0; i < STATISTICS_ADDRESS_10BIT_COUNT; i += 1) {
+			AppendAddressStatistics(ss, (U16)i, true, snapshot->addresses_10bit[i], display_base, sample_period);
+		}
+	}
+	ss << std::endl;
+	AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
+	ss.str("");
+
+	ss << "Start (s),End (s),Utilisation (%),Transactions" << std::endl;
+	AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
+	ss.str("");
+
+	/* only the most recent buckets are kept */
+	U64 num_buckets = have_stats ? snapshot->buckets_count : 0;
+	size_t first_bucket = have_stats ? (snapshot->buckets_next + STATISTICS_BUCKET_HISTORY - snapshot->buckets_count) % STATISTICS_BUCKET_HISTORY : 0;
+	for (U64 i = 0; i < num_buckets; i += 1) {
+		AppendBucketStatistics(ss, snapshot->buckets[(first_bucket + i) % STATISTICS_BUCKET_HISTORY], snapshot->bucket_samples, trigger_sample, sample_rate);
+		AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
+		ss.str("");
+
+		if (UpdateExportProgressAndCheckForCancel(i, num_buckets) == true) {
+			break;
+		}
+	}
+
+	/* the bucket that is still open */
+	if (have_stats && snapshot->BucketActive()) {
+		I2cBucketStatistics b;
+		b.start = snapshot->bucket_start;
+		b.end = snapshot->bucket_end;
+		b.busy = snapshot->bucket_busy;
+		b.transactions = snapshot->bucket_transactions;
+		AppendBucketStatistics(ss, b, snapshot->bucket_samples, trigger_sample, sample_rate);
+		AnalyzerHelpers::AppendToFile((U8*)ss.str().c_str(), (U32)ss.str().length(), f);
+		ss.str("");
+	}
+
+	UpdateExportProgressAndCheckForCancel(num_buckets, num_buckets);
+	AnalyzerHelpers::EndFile(f);
+}
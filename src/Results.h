@@ -6,6 +6,11 @@
 class I2cAnalyzer;
 class I2cAnalyzerSettings;
 
+enum ExportTypes {
+	EXPORT_TYPE_TRANSACTIONS,
+	EXPORT_TYPE_STATISTICS,
+};
+
 class I2cAnalyzerResults: public AnalyzerResults {
 	public:
 		I2cAnalyzerResults(I2cAnalyzer *analyzer, I2cAnalyzerSettings *settings);
@@ -18,6 +23,8 @@ class I2cAnalyzerResults: public AnalyzerResults {
 		virtual void GenerateTransactionTabularText(U64 transaction_id, DisplayBase display_base) {};
 
 	protected:
+		void GenerateStatisticsExportFile(const char *file, DisplayBase display_base);
+
 		I2cAnalyzer *analyzer;
 		I2cAnalyzerSettings *settings;
 };
@@ -5,12 +5,18 @@
 I2cAnalyzerSettings::I2cAnalyzerSettings():
 	scl_channel(UNDEFINED_CHANNEL),
 	sda_channel(UNDEFINED_CHANNEL),
+	bus_rate_hz(100000),
 	min_width_ns(30),
+	hs_min_width_ns(10),
 	filter_address_enable(false),
 	filter_address(0),
+	filter_address_10bit(false),
 	gen_control(true),
 	gen_frames(true),
-	gen_transactions(true)
+	gen_transactions(true),
+	stream_enable(false),
+	stream_path("/tmp/i2c-analyzer.sock"),
+	stats_interval_ms(0)
 {
 	ClearChannels();
 
@@ -26,6 +32,15 @@ I2cAnalyzerSettings::I2cAnalyzerSettings():
 	AddInterface(sda_channel_interface.get());
 	AddChannel(sda_channel, "SDA", false);
 
+	bus_rate_hz_interface.reset(new AnalyzerSettingInterfaceNumberList());
+	bus_rate_hz_interface->SetTitleAndTooltip("Bus Mode", "The fastest mode used on the bus, which sets the minimum sample rate");
+	bus_rate_hz_interface->AddNumber(100000, "Standard-mode (100 kHz)", "");
+	bus_rate_hz_interface->AddNumber(400000, "Fast-mode (400 kHz)", "");
+	bus_rate_hz_interface->AddNumber(1000000, "Fast-mode Plus (1 MHz)", "");
+	bus_rate_hz_interface->AddNumber(3400000, "High-speed mode (3.4 MHz)", "");
+	bus_rate_hz_interface->SetNumber(bus_rate_hz);
+	AddInterface(bus_rate_hz_interface.get());
+
 	min_width_ns_interface.reset(new AnalyzerSettingInterfaceInteger());
 	min_width_ns_interface->SetTitleAndTooltip("Min Width (ns)", "Pulses shorter than this are ignored, like a glitch filter");
 	min_width_ns_interface->SetMax(1000000);
@@ -33,6 +48,13 @@ I2cAnalyzerSettings::I2cAnalyzerSettings():
 	min_width_ns_interface->SetInteger(min_width_ns);
 	AddInterface(min_width_ns_interface.get());
 
+	hs_min_width_ns_interface.reset(new AnalyzerSettingInterfaceInteger());
+	hs_min_width_ns_interface->SetTitleAndTooltip("Hs Min Width (ns)", "Glitch filter used after a master code switches the bus to Hs-mode, until the next stop - rounded down to whole samples, so it has no effect if shorter than one sample");
+	hs_min_width_ns_interface->SetMax(1000000);
+	hs_min_width_ns_interface->SetMin(0);
+	hs_min_width_ns_interface->SetInteger(hs_min_width_ns);
+	AddInterface(hs_min_width_ns_interface.get());
+
 	filter_address_enable_interface.reset(new AnalyzerSettingInterfaceBool());
 	filter_address_enable_interface->SetTitleAndTooltip("Filter by Address", "Only decode for the nominated address");
 	filter_address_enable_interface->SetValue(filter_address_enable);
@@ -40,11 +62,16 @@ I2cAnalyzerSettings::I2cAnalyzerSettings():
 
 	filter_address_interface.reset(new AnalyzerSettingInterfaceInteger());
 	filter_address_interface->SetTitleAndTooltip("Filter Address", "Nominate an address - all others will be ignored");
-	filter_address_interface->SetMax(0x7f);
+	filter_address_interface->SetMax(0x3ff);
 	filter_address_interface->SetMin(0x00);
 	filter_address_interface->SetInteger(filter_address);
 	AddInterface(filter_address_interface.get());
 
+	filter_address_10bit_interface.reset(new AnalyzerSettingInterfaceBool());
+	filter_address_10bit_interface->SetTitleAndTooltip("Filter Address is 10-bit", "The nominated address is a 10-bit address");
+	filter_address_10bit_interface->SetValue(filter_address_10bit);
+	AddInterface(filter_address_10bit_interface.get());
+
 	gen_control_interface.reset(new AnalyzerSettingInterfaceBool());
 	gen_control_interface->SetTitleAndTooltip("Generate Control Info", "Add start / stop / error conditions to the data table");
 	gen_control_interface->SetValue(gen_control);
@@ -59,6 +86,23 @@ I2cAnalyzerSettings::I2cAnalyzerSettings():
 	gen_transactions_interface->SetTitleAndTooltip("Generate Transactions", "Add full transactions to the data table");
 	gen_transactions_interface->SetValue(gen_transactions);
 	AddInterface(gen_transactions_interface.get());
+
+	stream_enable_interface.reset(new AnalyzerSettingInterfaceBool());
+	stream_enable_interface->SetTitleAndTooltip("Stream Transactions", "Write binary transaction records to a unix socket or named pipe as they are decoded");
+	stream_enable_interface->SetValue(stream_enable);
+	AddInterface(stream_enable_interface.get());
+
+	stream_path_interface.reset(new AnalyzerSettingInterfaceText());
+	stream_path_interface->SetTitleAndTooltip("Stream Path", "Path of an existing unix socket or named pipe to write transactions to");
+	stream_path_interface->SetText(stream_path.c_str());
+	AddInterface(stream_path_interface.get());
+
+	stats_interval_ms_interface.reset(new AnalyzerSettingInterfaceInteger());
+	stats_interval_ms_interface->SetTitleAndTooltip("Statistics Interval (ms)", "Add bus utilisation and per-address statistics to the data table at this interval, or 0 to disable");
+	stats_interval_ms_interface->SetMax(3600000);
+	stats_interval_ms_interface->SetMin(0);
+	stats_interval_ms_interface->SetInteger(stats_interval_ms);
+	AddInterface(stats_interval_ms_interface.get());
 }
 
 bool I2cAnalyzerSettings::SetSettingsFromInterfaces() {
@@ -66,16 +110,39 @@ bool I2cAnalyzerSettings::SetSettingsFromInterfaces() {
 	sda_channel = sda_channel_interface->GetChannel();
 	filter_address_enable = filter_address_enable_interface->GetValue();
 	filter_address = filter_address_interface->GetInteger();
+	filter_address_10bit = filter_address_10bit_interface->GetValue();
+	bus_rate_hz = (U32)bus_rate_hz_interface->GetNumber();
 	min_width_ns = min_width_ns_interface->GetInteger();
+	hs_min_width_ns = hs_min_width_ns_interface->GetInteger();
 	gen_control = gen_control_interface->GetValue();
 	gen_frames = gen_frames_interface->GetValue();
 	gen_transactions = gen_transactions_interface->GetValue();
+	stream_enable = stream_enable_interface->GetValue();
+	stream_path = stream_path_interface->GetText();
+	stats_interval_ms = stats_interval_ms_interface->GetInteger();
 
 	if (scl_channel == sda_channel) {
 		SetErrorText("SCL and SDA can't be assigned to the same input.");
 		return false;
 	}
 
+	if (filter_address_enable && !filter_address_10bit && (filter_address > 0x7f)) {
+		SetErrorText("A 7-bit filter address must be no greater than 0x7F.");
+		return false;
+	}
+
+#ifdef _WIN32
+	if (stream_enable) {
+		SetErrorText("Streaming transactions is not supported on Windows.");
+		return false;
+	}
+#endif
+
+	if (stream_enable && (stream_path.length() == 0)) {
+		SetErrorText("A path is required to stream transactions.");
+		return false;
+	}
+
 	ClearChannels();
 	AddChannel(scl_channel, "SCL", true);
 	AddChannel(sda_channel, "SDA", true);
@@ -88,10 +155,16 @@ void I2cAnalyzerSettings::UpdateInterfacesFromSettings() {
 	sda_channel_interface->SetChannel(sda_channel);
 	filter_address_enable_interface->SetValue(filter_address_enable);
 	filter_address_interface->SetInteger(filter_address);
+	filter_address_10bit_interface->SetValue(filter_address_10bit);
+	bus_rate_hz_interface->SetNumber(bus_rate_hz);
 	min_width_ns_interface->SetInteger(min_width_ns);
+	hs_min_width_ns_interface->SetInteger(hs_min_width_ns);
 	gen_control_interface->SetValue(gen_control);
 	gen_frames_interface->SetValue(gen_frames);
 	gen_transactions_interface->SetValue(gen_transactions);
+	stream_enable_interface->SetValue(stream_enable);
+	stream_path_interface->SetText(stream_path.c_str());
+	stats_interval_ms_interface->SetInteger(stats_interval_ms);
 }
 
 void I2cAnalyzerSettings::LoadSettings(const char *settings) {
@@ -112,6 +185,17 @@ void I2cAnalyzerSettings::LoadSettings(const char *settings) {
 	txt >> gen_control;
 	txt >> gen_frames;
 	txt >> gen_transactions;
+	txt >> stream_enable;
+
+	const char *path;
+	if (txt >> &path) {
+		stream_path = path;
+	}
+
+	txt >> stats_interval_ms;
+	txt >> bus_rate_hz;
+	txt >> hs_min_width_ns;
+	txt >> filter_address_10bit;
 
 	ClearChannels();
 	AddChannel(scl_channel, "SCL", true);
@@ -132,6 +216,12 @@ const char *I2cAnalyzerSettings::SaveSettings() {
 	txt << gen_control;
 	txt << gen_frames;
 	txt << gen_transactions;
+	txt << stream_enable;
+	txt << stream_path.c_str();
+	txt << stats_interval_ms;
+	txt << bus_rate_hz;
+	txt << hs_min_width_ns;
+	txt << filter_address_10bit;
 
 	return SetReturnString(txt.GetString());
 }
@@ -1,6 +1,8 @@
 #ifndef I2C_ANALYZER_SETTINGS_H
 #define I2C_ANALYZER_SETTINGS_H
 
+#include <string>
+
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
 
@@ -18,24 +20,38 @@ class I2cAnalyzerSettings: public AnalyzerSettings {
 		Channel scl_channel;
 		Channel sda_channel;
 
+		U32 bus_rate_hz;
 		U32 min_width_ns;
+		U32 hs_min_width_ns;
 
 		bool filter_address_enable;
 		U32 filter_address;
+		bool filter_address_10bit;
 
 		bool gen_control;
 		bool gen_frames;
 		bool gen_transactions;
 
+		bool stream_enable;
+		std::string stream_path;
+
+		U32 stats_interval_ms;
+
 	protected:
 		std::auto_ptr<AnalyzerSettingInterfaceChannel> scl_channel_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceChannel> sda_channel_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceNumberList> bus_rate_hz_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceInteger> min_width_ns_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceInteger> hs_min_width_ns_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceBool> filter_address_enable_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceInteger> filter_address_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceBool> filter_address_10bit_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceBool> gen_control_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceBool> gen_frames_interface;
 		std::auto_ptr<AnalyzerSettingInterfaceBool> gen_transactions_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceBool> stream_enable_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceText> stream_path_interface;
+		std::auto_ptr<AnalyzerSettingInterfaceInteger> stats_interval_ms_interface;
 };
 
 #endif /* I2C_ANALYSER_SETTINGS_H */
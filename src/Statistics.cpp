@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "Statistics.h"
+
+I2cStatistics::I2cStatistics(U64 bucket_samples):
+	bucket_samples(bucket_samples),
+	bucket_start(0),
+	bucket_end(bucket_samples),
+	bucket_busy(0),
+	bucket_transactions(0),
+	buckets_next(0),
+	buckets_count(0),
+	span_start(0),
+	span_end(0)
+{
+	memset(addresses, 0, sizeof(addresses));
+	memset(addresses_10bit, 0, sizeof(addresses_10bit));
+}
+
+void I2cStatistics::Submit(U64 start, U64 end, U16 address, bool is_10bit, bool is_read, bool ack, bool error, size_t bytes) {
+	I2cAddressStatistics &a = is_10bit ? addresses_10bit[address & 0x3ff] : addresses[address & 0x7f];
+
+	if (is_read) {
+		a.reads += 1;
+	} else {
+		a.writes += 1;
+	}
+	a.bytes += bytes;
+	if (!ack) a.naks += 1;
+	if (error) a.errors += 1;
+	a.bus_samples += end - start;
+	a.active = true;
+
+	SubmitBusy(start, end);
+}
+
+void I2cStatistics::SubmitBusy(U64 start, U64 end) {
+	bucket_busy += Overlap(start, end);
+	bucket_transactions += 1;
+
+	span_start = start;
+	span_end = end;
+}
+
+void I2cStatistics::NextBucket(U64 pos) {
+	if (BucketActive()) {
+		I2cBucketStatistics &b = buckets[buckets_next];
+		b.start = bucket_start;
+		b.end = bucket_end;
+		b.busy = bucket_busy;
+		b.transactions = bucket_transactions;
+
+		buckets_next = (buckets_next + 1) % STATISTICS_BUCKET_HISTORY;
+		if (buckets_count < STATISTICS_BUCKET_HISTORY) buckets_count += 1;
+	}
+
+	if (span_end > bucket_end) {
+		/* the last transaction continues into the next bucket */
+		bucket_start = bucket_end;
+	} else {
+		/* skip over any idle buckets */
+		bucket_start = pos - (pos % bucket_samples);
+	}
+	bucket_end = bucket_start + bucket_samples;
+
+	bucket_busy = Overlap(span_start, span_end);
+	bucket_transactions = 0;
+
+	for (size_t i = 0; i < STATISTICS_ADDRESS_COUNT; i += 1) {
+		addresses[i].active = false;
+	}
+	for (size_t i = 0; i < STATISTICS_ADDRESS_10BIT_COUNT; i += 1) {
+		addresses_10bit[i].active = false;
+	}
+}
+
+U64 I2cStatistics::Overlap(U64 start, U64 end) const {
+	if (start < bucket_start) start = bucket_start;
+	if (end > bucket_end) end = bucket_end;
+	return (end > start) ? (end - start) : 0;
+}
@@ -0,0 +1,68 @@
+#ifndef I2C_ANALYZER_STATISTICS_H
+#define I2C_ANALYZER_STATISTICS_H
+
+#include <AnalyzerTypes.h>
+
+#define STATISTICS_ADDRESS_COUNT 128
+#define STATISTICS_ADDRESS_10BIT_COUNT 1024
+#define STATISTICS_BUCKET_HISTORY 1024
+
+struct I2cAddressStatistics {
+	U64 reads;
+	U64 writes;
+	U64 bytes;
+	U64 naks;
+	U64 errors;
+	U64 bus_samples;
+	bool active; /* did a transaction start in the current bucket? */
+};
+
+struct I2cBucketStatistics {
+	U64 start;
+	U64 end;
+	U64 busy;
+	U64 transactions;
+};
+
+/* accumulates per-address counters, and bus utilisation over fixed-width
+ * buckets of time... counters are cumulative for the whole capture, while
+ * the utilisation is reset at the start of each bucket.
+ *
+ * transactions must be submitted in order, with any due buckets closed
+ * (via BucketDue() / NextBucket()) before the transaction is submitted.
+ */
+class I2cStatistics {
+	public:
+		I2cStatistics(U64 bucket_samples);
+
+		void Submit(U64 start, U64 end, U16 address, bool is_10bit, bool is_read, bool ack, bool error, size_t bytes);
+		void SubmitBusy(U64 start, U64 end); /* utilisation only, for transactions without a known address */
+
+		bool BucketDue(U64 pos) const { return pos >= bucket_end; };
+		bool BucketActive() const { return (bucket_transactions > 0) || (bucket_busy > 0); };
+		void NextBucket(U64 pos);
+
+		I2cAddressStatistics addresses[STATISTICS_ADDRESS_COUNT];
+		I2cAddressStatistics addresses_10bit[STATISTICS_ADDRESS_10BIT_COUNT];
+
+		U64 bucket_samples;
+		U64 bucket_start;
+		U64 bucket_end;
+		U64 bucket_busy;
+		U64 bucket_transactions;
+
+		/* the most recent closed buckets that saw some activity, oldest first
+		 * from buckets[buckets_next] once the history has wrapped */
+		I2cBucketStatistics buckets[STATISTICS_BUCKET_HISTORY];
+		size_t buckets_next;
+		size_t buckets_count;
+
+	protected:
+		U64 Overlap(U64 start, U64 end) const;
+
+		/* the most recent transaction, which may extend into later buckets */
+		U64 span_start;
+		U64 span_end;
+};
+
+#endif /* I2C_ANALYZER_STATISTICS_H */
@@ -0,0 +1,306 @@
+#include <chrono>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include "Stream.h"
+
+/* bytes of records that will be held while waiting for the consumer */
+#define STREAM_RING_SIZE (1024 * 1024)
+/* the most bytes that will be taken from the ring in one go */
+#define STREAM_BATCH_MAX 65536
+/* time to wait between attempts to (re)open the destination */
+#define STREAM_OPEN_BACKOFF_MS 250
+/* time to wait for the destination to become writable, before checking for exit */
+#define STREAM_POLL_MS 50
+
+#define STREAM_HEADER_LEN 27
+
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+/* macOS, SO_NOSIGPIPE is set on the socket instead */
+#define MSG_NOSIGNAL 0
+#endif
+
+static void PutLE(std::vector<U8> &buf, U64 value, size_t len) {
+	for (size_t i = 0; i < len; i += 1) {
+		buf.push_back((U8)(value >> (i * 8)));
+	}
+}
+
+I2cStreamWriter::I2cStreamWriter(const char *path):
+	path(path),
+	fd(-1),
+	fd_is_socket(false),
+	sequence(0),
+	ring(STREAM_RING_SIZE),
+	ring_head(0),
+	ring_used(0),
+	stop(false),
+	batch_offset(0)
+{
+	record.reserve(STREAM_HEADER_LEN + 256);
+	batch.reserve(STREAM_BATCH_MAX);
+
+#ifndef _WIN32
+	thread = std::thread(&I2cStreamWriter::WriterThread, this);
+#endif
+}
+
+I2cStreamWriter::~I2cStreamWriter() {
+	{
+		std::lock_guard<std::mutex> l(lock);
+		stop = true;
+	}
+	wake.notify_all();
+
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void I2cStreamWriter::Submit(S64 start_ns, S64 end_ns, U16 address, U8 flags, const U8 *payload, size_t payload_len) {
+	record.clear();
+
+	PutLE(record, STREAM_HEADER_LEN - 4 + payload_len, 4);
+	PutLE(record, sequence, 4);
+	PutLE(record, (U64)start_ns, 8);
+	PutLE(record, (U64)end_ns, 8);
+	PutLE(record, address, 2);
+	PutLE(record, flags, 1);
+	record.insert(record.end(), payload, payload + payload_len);
+
+	sequence += 1;
+
+	/* too big to ever be queued, the gap in sequence numbers reveals it */
+	if (record.size() > ring.size()) return;
+
+	{
+		std::lock_guard<std::mutex> l(lock);
+
+		while (ring.size() - ring_used < record.size()) {
+			RingDropOldest();
+		}
+		RingWrite(&(record[0]), record.size());
+	}
+	wake.notify_one();
+}
+
+void I2cStreamWriter::WriterThread() {
+#ifndef _WIN32
+	/* writing to a named pipe with no reader raises SIGPIPE, so keep it
+	 * pending on this thread (and consume it) rather than let it kill the
+	 * application... sockets use MSG_NOSIGNAL / SO_NOSIGPIPE instead */
+	sigset_t set, old_set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, &old_set);
+
+	std::chrono::steady_clock::time_point next_open = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> l(lock);
+
+	while (!stop) {
+		if (fd < 0) {
+			if (std::chrono::steady_clock::now() < next_open) {
+				wake.wait_until(l, next_open);
+				continue;
+			}
+
+			l.unlock();
+			bool opened = Open();
+			l.lock();
+
+			if (!opened) {
+				next_open = std::chrono::steady_clock::now() + std::chrono::milliseconds(STREAM_OPEN_BACKOFF_MS);
+				continue;
+			}
+		}
+
+		if (batch_offset >= batch.size()) {
+			if (ring_used == 0) {
+				wake.wait(l);
+				continue;
+			}
+			TakeBatch();
+		}
+
+		l.unlock();
+		bool ok = WriteBatch();
+		l.lock();
+
+		if (!ok) {
+			/* consumer has gone away - the part-written batch is lost */
+			Close();
+			batch.clear();
+			batch_offset = 0;
+			next_open = std::chrono::steady_clock::now() + std::chrono::milliseconds(STREAM_OPEN_BACKOFF_MS);
+		}
+	}
+
+	l.unlock();
+	Close();
+
+	int sig;
+	sigset_t pending;
+	sigpending(&pending);
+	if (sigismember(&pending, SIGPIPE)) {
+		sigwait(&set, &sig);
+	}
+	pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+#endif
+}
+
+/* returns false if the destination should be closed */
+bool I2cStreamWriter::WriteBatch() {
+#ifdef _WIN32
+	return false;
+#else
+	const U8 *p = &(batch[batch_offset]);
+	size_t n = batch.size() - batch_offset;
+
+	ssize_t ret = fd_is_socket ? send(fd, p, n, MSG_NOSIGNAL) : write(fd, p, n);
+	if (ret >= 0) {
+		batch_offset += (size_t)ret;
+		return true;
+	}
+
+	if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		poll(&pfd, 1, STREAM_POLL_MS);
+		return (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) == 0;
+	}
+
+	if (errno == EINTR) {
+		return true;
+	}
+
+	if (errno == EPIPE) {
+		int sig;
+		sigset_t set, pending;
+		sigemptyset(&set);
+		sigaddset(&set, SIGPIPE);
+		sigpending(&pending);
+		if (sigismember(&pending, SIGPIPE)) {
+			sigwait(&set, &sig);
+		}
+	}
+
+	return false;
+#endif
+}
+
+bool I2cStreamWriter::Open() {
+#ifdef _WIN32
+	return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+
+	if (S_ISFIFO(st.st_mode)) {
+		/* fails with ENXIO until there is a reader */
+		fd = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+		if (fd < 0) return false;
+		fd_is_socket = false;
+
+	} else if (S_ISSOCK(st.st_mode)) {
+		struct sockaddr_un addr;
+		if (path.length() >= sizeof(addr.sun_path)) return false;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) return false;
+		fd_is_socket = true;
+
+#ifdef SO_NOSIGPIPE
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+		if ((fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) ||
+		    (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)) {
+			Close();
+			return false;
+		}
+
+	} else {
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+void I2cStreamWriter::Close() {
+#ifndef _WIN32
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+#endif
+}
+
+/* move whole records from the ring into the batch, called with the lock held */
+void I2cStreamWriter::TakeBatch() {
+	batch.clear();
+	batch_offset = 0;
+
+	while (ring_used > 0) {
+		size_t len = RingRecordLength();
+		if ((batch.size() > 0) && (batch.size() + len > STREAM_BATCH_MAX)) break;
+
+		size_t offset = batch.size();
+		batch.resize(offset + len);
+		RingRead(0, &(batch[offset]), len);
+
+		ring_head = (ring_head + len) % ring.size();
+		ring_used -= len;
+	}
+}
+
+void I2cStreamWriter::RingRead(size_t offset, U8 *dst, size_t len) const {
+	size_t start = (ring_head + offset) % ring.size();
+	size_t first = ring.size() - start;
+	if (first > len) first = len;
+
+	memcpy(dst, &(ring[start]), first);
+	memcpy(dst + first, &(ring[0]), len - first);
+}
+
+void I2cStreamWriter::RingWrite(const U8 *src, size_t len) {
+	size_t start = (ring_head + ring_used) % ring.size();
+	size_t first = ring.size() - start;
+	if (first > len) first = len;
+
+	memcpy(&(ring[start]), src, first);
+	memcpy(&(ring[0]), src + first, len - first);
+
+	ring_used += len;
+}
+
+/* total length of the oldest record, including its length prefix */
+size_t I2cStreamWriter::RingRecordLength() const {
+	U8 b[4];
+	RingRead(0, b, sizeof(b));
+	return 4 + ((size_t)b[0] | ((size_t)b[1] << 8) | ((size_t)b[2] << 16) | ((size_t)b[3] << 24));
+}
+
+void I2cStreamWriter::RingDropOldest() {
+	size_t len = RingRecordLength();
+	ring_head = (ring_head + len) % ring.size();
+	ring_used -= len;
+}
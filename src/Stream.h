@@ -0,0 +1,78 @@
+#ifndef I2C_ANALYZER_STREAM_H
+#define I2C_ANALYZER_STREAM_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <AnalyzerTypes.h>
+
+#define STREAM_FLAG_READ    (1 << 0)
+#define STREAM_FLAG_ACK     (1 << 1)
+#define STREAM_FLAG_RESTART (1 << 2)
+#define STREAM_FLAG_ERROR   (1 << 3)
+#define STREAM_FLAG_10BIT   (1 << 4)
+#define STREAM_FLAG_HS      (1 << 5)
+#define STREAM_FLAG_ADDRESS_UNKNOWN (1 << 6) /* only the top two bits of the 10-bit address are valid */
+
+/* writes length-prefixed binary transaction records to a unix domain socket
+ * or named pipe, all values are little-endian:
+ *
+ *   u32  length of the remainder of the record
+ *   u32  sequence number (gaps indicate dropped records)
+ *   s64  start time (ns, relative to the trigger)
+ *   s64  end time (ns, relative to the trigger)
+ *   u16  address (without r/w flag)
+ *   u8   flags (STREAM_FLAG_*)
+ *   u8[] payload
+ *
+ * records are queued in a fixed-size ring buffer, and written out by a
+ * separate thread that never blocks on the destination - if the consumer
+ * can't keep up then the oldest records are dropped, so the decoder is never
+ * stalled.
+ */
+class I2cStreamWriter {
+	public:
+		I2cStreamWriter(const char *path);
+		~I2cStreamWriter();
+
+		void Submit(S64 start_ns, S64 end_ns, U16 address, U8 flags, const U8 *payload, size_t payload_len);
+
+	protected:
+		void WriterThread();
+		bool Open();
+		void Close();
+		bool WriteBatch();
+
+		void TakeBatch();
+		void RingRead(size_t offset, U8 *dst, size_t len) const;
+		void RingWrite(const U8 *src, size_t len);
+		size_t RingRecordLength() const;
+		void RingDropOldest();
+
+		std::string path;
+		int fd;
+		bool fd_is_socket;
+
+		/* owned by the decoder thread */
+		U32 sequence;
+		std::vector<U8> record;
+
+		/* shared, guarded by lock */
+		std::vector<U8> ring;
+		size_t ring_head;
+		size_t ring_used;
+		bool stop;
+
+		/* owned by the writer thread - whole records taken from the ring */
+		std::vector<U8> batch;
+		size_t batch_offset;
+
+		std::mutex lock;
+		std::condition_variable wake;
+		std::thread thread;
+};
+
+#endif /* I2C_ANALYZER_STREAM_H */